@@ -31,11 +31,18 @@
 #endif
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 #include <sys/types.h>
 #include "gdb_sys_time.h"
 #include "gdb_select.h"
 #include "observable.h"
 #include "top.h"
+#include "selftest.h"
+#include "common/filestuff.h"
+#include <array>
 
 /* Tell create_file_handler what events we are interested in.
    This is used by the select version of the event loop.  */
@@ -157,6 +164,22 @@ async_event_handler;
 
 static unsigned char use_poll = USE_POLL;
 
+/* Do we use epoll on top of poll?  With epoll, the kernel keeps the
+   set of monitored file descriptors, and tells us directly which one
+   is ready, so the cost of waiting for an event doesn't grow with the
+   number of registered file descriptors.  The poll bookkeeping is
+   still maintained, so that we can fall back to poll at any time,
+   e.g., when a file descriptor that epoll doesn't support (like a
+   regular file) is registered.  */
+#if defined (HAVE_POLL) && defined (HAVE_SYS_EPOLL_H) \
+  && defined (HAVE_EPOLL_CREATE1)
+#define USE_EPOLL 1
+#else
+#define USE_EPOLL 0
+#endif
+
+static unsigned char use_epoll = USE_EPOLL;
+
 #ifdef USE_WIN32API
 #include <windows.h>
 #include <io.h>
@@ -208,6 +231,127 @@ static struct
   }
 gdb_notifier;
 
+#if USE_EPOLL
+
+/* The poll event bits are passed to and from epoll unchanged.  */
+gdb_static_assert (POLLIN == EPOLLIN && POLLPRI == EPOLLPRI
+		   && POLLOUT == EPOLLOUT && POLLERR == EPOLLERR
+		   && POLLHUP == EPOLLHUP);
+
+/* State of the epoll variant.  */
+
+static struct
+  {
+    /* The epoll instance, or -1 if it hasn't been created yet.  */
+    int epoll_fd = -1;
+
+    /* The file handlers registered with EPOLL_FD, indexed by file
+       descriptor.  */
+    std::vector<file_handler *> handlers;
+
+    /* The registration serial numbers of the file handlers in
+       HANDLERS.  The serial number of a registration is passed to
+       epoll along with the file descriptor, so that events for stale
+       registrations can be told apart from events for a new file
+       handler that reuses the same file descriptor number.  */
+    std::vector<unsigned int> serials;
+
+    /* Serial number of the last registration.  */
+    unsigned int last_serial = 0;
+  }
+epoll_notifier;
+
+/* Stop using epoll, and go back to plain poll.  Since the poll_fds
+   array is kept up to date even when epoll is in use, nothing else
+   needs to be done.  */
+
+static void
+epoll_disable (void)
+{
+  if (epoll_notifier.epoll_fd >= 0)
+    close (epoll_notifier.epoll_fd);
+  epoll_notifier.epoll_fd = -1;
+  epoll_notifier.handlers.clear ();
+  epoll_notifier.serials.clear ();
+  use_epoll = 0;
+}
+
+/* Register FILE_PTR with the epoll instance, creating it if
+   necessary.  MASK is the combination of poll events to monitor.  If
+   epoll can't be used for this file descriptor, fall back to
+   poll.  */
+
+static void
+epoll_add_file_handler (file_handler *file_ptr, int mask)
+{
+  int fd = file_ptr->fd;
+
+  if (epoll_notifier.epoll_fd < 0)
+    {
+      epoll_notifier.epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+      if (epoll_notifier.epoll_fd < 0)
+	{
+	  epoll_disable ();
+	  return;
+	}
+    }
+
+  unsigned int serial = ++epoll_notifier.last_serial;
+  struct epoll_event event;
+
+  event.events = mask;
+  event.data.u64 = ((uint64_t) serial << 32) | (uint32_t) fd;
+
+  /* Regular files and directories can't be monitored with epoll
+     (EPERM).  */
+  if (epoll_ctl (epoll_notifier.epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+      epoll_disable ();
+      return;
+    }
+
+  if (epoll_notifier.handlers.size () <= (size_t) fd)
+    {
+      epoll_notifier.handlers.resize (fd + 1);
+      epoll_notifier.serials.resize (fd + 1);
+    }
+  epoll_notifier.handlers[fd] = file_ptr;
+  epoll_notifier.serials[fd] = serial;
+}
+
+/* Unregister the file descriptor FD from the epoll instance.  */
+
+static void
+epoll_delete_file_handler (int fd)
+{
+  /* This fails with EBADF if FD was already closed, which also took
+     it out of the epoll set, unless some other file descriptor refers
+     to the same open file description.  That case is caught by
+     epoll_lookup_file_handler.  */
+  epoll_ctl (epoll_notifier.epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+
+  if ((size_t) fd < epoll_notifier.handlers.size ())
+    epoll_notifier.handlers[fd] = NULL;
+}
+
+/* Return the file handler that EVENT was reported for, or NULL if
+   EVENT belongs to a stale registration.  */
+
+static file_handler *
+epoll_lookup_file_handler (const struct epoll_event &event)
+{
+  int fd = (int) (uint32_t) event.data.u64;
+  unsigned int serial = event.data.u64 >> 32;
+
+  if (fd < 0 || (size_t) fd >= epoll_notifier.handlers.size ()
+      || epoll_notifier.serials[fd] != serial)
+    return NULL;
+
+  return epoll_notifier.handlers[fd];
+}
+
+#endif /* USE_EPOLL */
+
 /* Structure associated with a timer.  PROC will be executed at the
    first occasion after WHEN.  */
 struct gdb_timer
@@ -501,6 +645,10 @@ create_file_handler (int fd, int mask, handler_func * proc,
 	  (gdb_notifier.poll_fds + gdb_notifier.num_fds - 1)->fd = fd;
 	  (gdb_notifier.poll_fds + gdb_notifier.num_fds - 1)->events = mask;
 	  (gdb_notifier.poll_fds + gdb_notifier.num_fds - 1)->revents = 0;
+#if USE_EPOLL
+	  if (use_epoll)
+	    epoll_add_file_handler (file_ptr, mask);
+#endif
 #else
 	  internal_error (__FILE__, __LINE__,
 			  _("use_poll without HAVE_POLL"));
@@ -605,6 +753,10 @@ delete_file_handler (int fd)
       xfree (gdb_notifier.poll_fds);
       gdb_notifier.poll_fds = new_poll_fds;
       gdb_notifier.num_fds--;
+#if USE_EPOLL
+      if (use_epoll)
+	epoll_delete_file_handler (fd);
+#endif
 #else
       internal_error (__FILE__, __LINE__,
 		      _("use_poll without HAVE_POLL"));
@@ -747,6 +899,9 @@ gdb_wait_for_event (int block)
 {
   file_handler *file_ptr;
   int num_found = 0;
+#if USE_EPOLL
+  struct epoll_event epoll_event;
+#endif
 
   /* Make sure all output is done before getting another event.  */
   gdb_flush (gdb_stdout);
@@ -768,13 +923,33 @@ gdb_wait_for_event (int block)
       else
 	timeout = 0;
 
-      num_found = poll (gdb_notifier.poll_fds,
-			(unsigned long) gdb_notifier.num_fds, timeout);
+#if USE_EPOLL
+      if (use_epoll)
+	{
+	  /* Ask for a single event.  epoll queues a level-triggered
+	     file descriptor that is still ready back at the end of its
+	     ready list after reporting it, so this serves the file
+	     descriptors in a round-robin fashion, like the poll
+	     variant below does.  */
+	  num_found = epoll_wait (epoll_notifier.epoll_fd, &epoll_event,
+				  1, timeout);
+
+	  /* Don't print anything if we get out of epoll_wait because
+	     of a signal.  */
+	  if (num_found == -1 && errno != EINTR)
+	    perror_with_name (("epoll_wait"));
+	}
+      else
+#endif
+	{
+	  num_found = poll (gdb_notifier.poll_fds,
+			    (unsigned long) gdb_notifier.num_fds, timeout);
 
-      /* Don't print anything if we get out of poll because of a
-	 signal.  */
-      if (num_found == -1 && errno != EINTR)
-	perror_with_name (("poll"));
+	  /* Don't print anything if we get out of poll because of a
+	     signal.  */
+	  if (num_found == -1 && errno != EINTR)
+	    perror_with_name (("poll"));
+	}
 #else
       internal_error (__FILE__, __LINE__,
 		      _("use_poll without HAVE_POLL"));
@@ -835,6 +1010,26 @@ gdb_wait_for_event (int block)
       int i;
       int mask;
 
+#if USE_EPOLL
+      if (use_epoll)
+	{
+	  file_ptr = epoll_lookup_file_handler (epoll_event);
+	  if (file_ptr == NULL)
+	    {
+	      /* An event for a file descriptor that was closed without
+		 being unregistered first, while another file descriptor
+		 still refers to the same file.  There's no way to take
+		 it out of the epoll set anymore, so go back to
+		 poll.  */
+	      epoll_disable ();
+	      return 0;
+	    }
+
+	  handle_file_event (file_ptr, epoll_event.events);
+	  return 1;
+	}
+#endif
+
       while (1)
 	{
 	  if (gdb_notifier.next_poll_fds_index >= gdb_notifier.num_fds)
@@ -1280,3 +1475,108 @@ poll_timers (void)
 
   return 0;
 }
+
+#if GDB_SELF_TEST
+namespace selftests {
+namespace event_loop {
+
+/* The pipes used by test_file_handlers.  */
+static std::vector<std::array<int, 2>> test_pipes;
+
+/* The number of times the handler of each pipe in TEST_PIPES was
+   called.  */
+static std::vector<int> test_calls;
+
+/* File handler for the read end of a test pipe.  CLIENT_DATA is the
+   index of the pipe in TEST_PIPES.  */
+
+static void
+test_file_handler (int err, gdb_client_data client_data)
+{
+  size_t index = (uintptr_t) client_data;
+  char c;
+
+  SELF_CHECK (!err);
+  SELF_CHECK (read (test_pipes[index][0], &c, 1) == 1);
+  test_calls[index]++;
+}
+
+/* Process all the file events that are ready, without blocking.  */
+
+static void
+test_drain_file_events ()
+{
+  /* Other event sources (the console, for instance) may be registered
+     too, so just make sure this can't loop forever.  */
+  for (size_t i = 0; i < 2 * test_pipes.size () + 16; i++)
+    if (gdb_wait_for_event (0) <= 0)
+      break;
+}
+
+/* Register COUNT pipes with the event loop, make some of them ready,
+   and check that exactly the ready ones have their handler
+   called.  */
+
+static void
+test_file_handlers (size_t count)
+{
+  test_pipes.resize (count);
+  test_calls.assign (count, 0);
+
+  for (size_t i = 0; i < count; i++)
+    {
+      SELF_CHECK (gdb_pipe_cloexec (test_pipes[i].data ()) == 0);
+      add_file_handler (test_pipes[i][0], test_file_handler,
+			(gdb_client_data) (uintptr_t) i);
+    }
+
+  for (size_t i = 0; i < count; i += 3)
+    SELF_CHECK (write (test_pipes[i][1], "x", 1) == 1);
+
+  test_drain_file_events ();
+
+  for (size_t i = 0; i < count; i++)
+    SELF_CHECK (test_calls[i] == (i % 3 == 0 ? 1 : 0));
+
+  /* A deleted file handler must not be called anymore, even if its
+     file descriptor is ready.  */
+  delete_file_handler (test_pipes[0][0]);
+  SELF_CHECK (write (test_pipes[0][1], "x", 1) == 1);
+  SELF_CHECK (write (test_pipes[count - 1][1], "x", 1) == 1);
+
+  test_drain_file_events ();
+
+  SELF_CHECK (test_calls[0] == 1);
+  if (count > 1)
+    SELF_CHECK (test_calls[count - 1] == ((count - 1) % 3 == 0 ? 2 : 1));
+
+  for (size_t i = 0; i < count; i++)
+    {
+      delete_file_handler (test_pipes[i][0]);
+      close (test_pipes[i][0]);
+      close (test_pipes[i][1]);
+    }
+
+  test_pipes.clear ();
+  test_calls.clear ();
+}
+
+static void
+run_tests ()
+{
+  test_file_handlers (1);
+  test_file_handlers (16);
+  test_file_handlers (256);
+}
+
+} /* namespace event_loop */
+} /* namespace selftests */
+#endif /* GDB_SELF_TEST */
+
+void
+_initialize_event_loop (void)
+{
+#if GDB_SELF_TEST
+  selftests::register_test ("event-loop", selftests::event_loop::run_tests);
+#endif
+}
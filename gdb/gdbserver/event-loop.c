@@ -30,6 +30,25 @@
 
 #include <unistd.h>
 #include <queue>
+#include <vector>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+/* Do we use epoll instead of select?  With epoll, the kernel keeps
+   the set of monitored file descriptors and tells us directly which
+   ones are ready, so the cost of waiting for events doesn't grow with
+   the number of registered file descriptors.  The select masks are
+   still maintained, so that we can fall back to select at any
+   time.  */
+#if defined (HAVE_SYS_EPOLL_H) && defined (HAVE_EPOLL_CREATE1)
+#define USE_EPOLL 1
+#else
+#define USE_EPOLL 0
+#endif
+
+static unsigned char use_epoll = USE_EPOLL;
 
 typedef int (event_handler_func) (gdb_fildes_t);
 
@@ -114,6 +133,133 @@ static struct
   }
 gdb_notifier;
 
+#if USE_EPOLL
+
+/* Maximum number of events collected by a single call to
+   epoll_wait.  Any other ready file descriptor is reported by the
+   next call.  */
+#define EPOLL_MAX_EVENTS 32
+
+/* State of the epoll variant.  */
+
+static struct
+  {
+    /* The epoll instance, or -1 if it hasn't been created yet.  */
+    int epoll_fd = -1;
+
+    /* The file handlers registered with EPOLL_FD, indexed by file
+       descriptor.  */
+    std::vector<file_handler *> handlers;
+
+    /* The registration serial numbers of the file handlers in
+       HANDLERS.  The serial number is passed to epoll along with the
+       file descriptor, so that events for stale registrations can be
+       told apart from events for a new file handler that reuses the
+       same file descriptor number.  */
+    std::vector<unsigned int> serials;
+
+    /* Serial number of the last registration.  */
+    unsigned int last_serial = 0;
+  }
+epoll_notifier;
+
+/* Stop using epoll, and go back to select.  Since the select masks
+   are kept up to date even when epoll is in use, nothing else needs
+   to be done.  */
+
+static void
+epoll_disable (void)
+{
+  if (epoll_notifier.epoll_fd >= 0)
+    close (epoll_notifier.epoll_fd);
+  epoll_notifier.epoll_fd = -1;
+  epoll_notifier.handlers.clear ();
+  epoll_notifier.serials.clear ();
+  use_epoll = 0;
+}
+
+/* Register FILE_PTR with the epoll instance, creating it if
+   necessary.  MASK is a combination of READABLE, WRITABLE and
+   EXCEPTION.  If epoll can't be used for this file descriptor, fall
+   back to select.  */
+
+static void
+epoll_add_file_handler (file_handler *file_ptr, int mask)
+{
+  gdb_fildes_t fd = file_ptr->fd;
+
+  if (epoll_notifier.epoll_fd < 0)
+    {
+      epoll_notifier.epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+      if (epoll_notifier.epoll_fd < 0)
+	{
+	  epoll_disable ();
+	  return;
+	}
+    }
+
+  unsigned int serial = ++epoll_notifier.last_serial;
+  struct epoll_event event;
+
+  event.events = 0;
+  if (mask & GDB_READABLE)
+    event.events |= EPOLLIN;
+  if (mask & GDB_WRITABLE)
+    event.events |= EPOLLOUT;
+  if (mask & GDB_EXCEPTION)
+    event.events |= EPOLLPRI;
+  event.data.u64 = ((uint64_t) serial << 32) | (uint32_t) fd;
+
+  /* Regular files and directories can't be monitored with epoll
+     (EPERM).  */
+  if (epoll_ctl (epoll_notifier.epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+      epoll_disable ();
+      return;
+    }
+
+  if (epoll_notifier.handlers.size () <= (size_t) fd)
+    {
+      epoll_notifier.handlers.resize (fd + 1);
+      epoll_notifier.serials.resize (fd + 1);
+    }
+  epoll_notifier.handlers[fd] = file_ptr;
+  epoll_notifier.serials[fd] = serial;
+}
+
+/* Unregister the file descriptor FD from the epoll instance.  */
+
+static void
+epoll_delete_file_handler (gdb_fildes_t fd)
+{
+  /* This fails with EBADF if FD was already closed, which also took
+     it out of the epoll set, unless some other file descriptor refers
+     to the same open file description.  That case is caught by
+     wait_for_event.  */
+  epoll_ctl (epoll_notifier.epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+
+  if ((size_t) fd < epoll_notifier.handlers.size ())
+    epoll_notifier.handlers[fd] = NULL;
+}
+
+/* Return the file handler that EVENT was reported for, or NULL if
+   EVENT belongs to a stale registration.  */
+
+static file_handler *
+epoll_lookup_file_handler (const struct epoll_event &event)
+{
+  gdb_fildes_t fd = (gdb_fildes_t) (uint32_t) event.data.u64;
+  unsigned int serial = event.data.u64 >> 32;
+
+  if (fd < 0 || (size_t) fd >= epoll_notifier.handlers.size ()
+      || epoll_notifier.serials[fd] != serial)
+    return NULL;
+
+  return epoll_notifier.handlers[fd];
+}
+
+#endif /* USE_EPOLL */
+
 /* Callbacks are just routines that are executed before waiting for the
    next event.  In GDB this is struct gdb_timer.  We don't need timers
    so rather than copy all that complexity in gdbserver, we provide what
@@ -301,6 +447,11 @@ create_file_handler (gdb_fildes_t fd, int mask, handler_func *proc,
 
       if (gdb_notifier.num_fds <= fd)
 	gdb_notifier.num_fds = fd + 1;
+
+#if USE_EPOLL
+      if (use_epoll)
+	epoll_add_file_handler (file_ptr, mask);
+#endif
     }
 
   file_ptr->proc = proc;
@@ -344,6 +495,11 @@ delete_file_handler (gdb_fildes_t fd)
   if (file_ptr->mask & GDB_EXCEPTION)
     FD_CLR (fd, &gdb_notifier.check_masks[2]);
 
+#if USE_EPOLL
+  if (use_epoll)
+    epoll_delete_file_handler (fd);
+#endif
+
   /* Find current max fd.  */
 
   if ((fd + 1) == gdb_notifier.num_fds)
@@ -391,35 +547,47 @@ handle_file_event (gdb_fildes_t event_file_desc)
 
   /* Search the file handler list to find one that matches the fd in
      the event.  */
-  for (file_ptr = gdb_notifier.first_file_handler; file_ptr != NULL;
-       file_ptr = file_ptr->next_file)
+#if USE_EPOLL
+  if (use_epoll)
     {
+      /* epoll keeps an index of the file handlers by file
+	 descriptor.  */
+      if ((size_t) event_file_desc < epoll_notifier.handlers.size ())
+	file_ptr = epoll_notifier.handlers[event_file_desc];
+      else
+	file_ptr = NULL;
+    }
+  else
+#endif
+    for (file_ptr = gdb_notifier.first_file_handler; file_ptr != NULL;
+	 file_ptr = file_ptr->next_file)
       if (file_ptr->fd == event_file_desc)
+	break;
+
+  if (file_ptr != NULL)
+    {
+      /* See if the desired events (mask) match the received events
+	 (ready_mask).  */
+
+      if (file_ptr->ready_mask & GDB_EXCEPTION)
 	{
-	  /* See if the desired events (mask) match the received
-	     events (ready_mask).  */
-
-	  if (file_ptr->ready_mask & GDB_EXCEPTION)
-	    {
-	      warning ("Exception condition detected on fd %s",
-		       pfildes (file_ptr->fd));
-	      file_ptr->error = 1;
-	    }
-	  else
-	    file_ptr->error = 0;
-	  mask = file_ptr->ready_mask & file_ptr->mask;
-
-	  /* Clear the received events for next time around.  */
-	  file_ptr->ready_mask = 0;
-
-	  /* If there was a match, then call the handler.  */
-	  if (mask != 0)
-	    {
-	      if ((*file_ptr->proc) (file_ptr->error,
-				     file_ptr->client_data) < 0)
-		return -1;
-	    }
-	  break;
+	  warning ("Exception condition detected on fd %s",
+		   pfildes (file_ptr->fd));
+	  file_ptr->error = 1;
+	}
+      else
+	file_ptr->error = 0;
+      mask = file_ptr->ready_mask & file_ptr->mask;
+
+      /* Clear the received events for next time around.  */
+      file_ptr->ready_mask = 0;
+
+      /* If there was a match, then call the handler.  */
+      if (mask != 0)
+	{
+	  if ((*file_ptr->proc) (file_ptr->error,
+				 file_ptr->client_data) < 0)
+	    return -1;
 	}
     }
 
@@ -443,6 +611,79 @@ create_file_event (gdb_fildes_t fd)
   return file_event_ptr;
 }
 
+/* Record that the events in MASK were detected on FILE_PTR's file
+   descriptor.  Enqueue an event only if this is still a new event for
+   this fd.  */
+
+static void
+queue_file_event (file_handler *file_ptr, int mask)
+{
+  if (file_ptr->ready_mask == 0)
+    {
+      gdb_event *file_event_ptr = create_file_event (file_ptr->fd);
+
+      event_queue.emplace (file_event_ptr);
+    }
+  file_ptr->ready_mask = mask;
+}
+
+#if USE_EPOLL
+
+/* The epoll variant of wait_for_event.  */
+
+static int
+epoll_wait_for_event (void)
+{
+  struct epoll_event events[EPOLL_MAX_EVENTS];
+  int num_found;
+
+  num_found = epoll_wait (epoll_notifier.epoll_fd, events,
+			  EPOLL_MAX_EVENTS, -1);
+
+  if (num_found == -1)
+    {
+      /* Dont print anything if we got a signal, let gdb handle
+	 it.  */
+      if (errno != EINTR)
+	perror_with_name ("epoll_wait");
+      return 0;
+    }
+
+  /* Enqueue all detected file events.  */
+
+  for (int i = 0; i < num_found; i++)
+    {
+      file_handler *file_ptr = epoll_lookup_file_handler (events[i]);
+      int mask = 0;
+
+      if (file_ptr == NULL)
+	{
+	  /* An event for a file descriptor that was closed without
+	     being unregistered first, while another file descriptor
+	     still refers to the same file.  There's no way to take it
+	     out of the epoll set anymore, so go back to select.  The
+	     events already queued are still valid.  */
+	  epoll_disable ();
+	  return 0;
+	}
+
+      /* Like select, report hangups and errors as readability, so
+	 that the handler gets to see the EOF or the error.  */
+      if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+	mask |= GDB_READABLE;
+      if (events[i].events & EPOLLOUT)
+	mask |= GDB_WRITABLE;
+      if (events[i].events & EPOLLPRI)
+	mask |= GDB_EXCEPTION;
+
+      queue_file_event (file_ptr, mask);
+    }
+
+  return 0;
+}
+
+#endif /* USE_EPOLL */
+
 /* Called by do_one_event to wait for new events on the monitored file
    descriptors.  Queue file events as they are detected by the poll.
    If there are no events, this function will block in the call to
@@ -462,6 +703,11 @@ wait_for_event (void)
   if (gdb_notifier.num_fds == 0)
     return -1;
 
+#if USE_EPOLL
+  if (use_epoll)
+    return epoll_wait_for_event ();
+#endif
+
   gdb_notifier.ready_masks[0] = gdb_notifier.check_masks[0];
   gdb_notifier.ready_masks[1] = gdb_notifier.check_masks[1];
   gdb_notifier.ready_masks[2] = gdb_notifier.check_masks[2];
@@ -505,16 +751,7 @@ wait_for_event (void)
       else
 	num_found--;
 
-      /* Enqueue an event only if this is still a new event for this
-	 fd.  */
-
-      if (file_ptr->ready_mask == 0)
-	{
-	  gdb_event *file_event_ptr = create_file_event (file_ptr->fd);
-
-	  event_queue.emplace (file_event_ptr);
-	}
-      file_ptr->ready_mask = mask;
+      queue_file_event (file_ptr, mask);
     }
 
   return 0;
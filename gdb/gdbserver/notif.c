@@ -45,7 +45,14 @@
    until queue is empty.  Then, GDBserver sends 'OK' to GDB that all
    queued notification events are done.
 
-   # 3 is done by function 'handle_notif_ack'.  */
+   # 3 is done by function 'handle_notif_ack'.
+
+   When several events are expected to happen at once (for example,
+   many threads hitting the same breakpoint), they can be pushed as a
+   batch between 'notif_batch_begin' and 'notif_batch_end'.  Then only
+   one notification packet is sent for the whole batch, once all of
+   them are in the queue, and GDB fetches them all in a single
+   sequence of acks.  */
 
 #include "server.h"
 #include "notif.h"
@@ -129,6 +136,21 @@ notif_event_enque (struct notif_server *notif,
 
 }
 
+/* Send the notification packet of NP for EVENT.  */
+
+static void
+notif_send (struct notif_server *np, struct notif_event *event)
+{
+  char buf[PBUFSIZ];
+  char *p = buf;
+
+  xsnprintf (p, PBUFSIZ, "%s:", np->notif_name);
+  p += strlen (p);
+
+  np->write (event, p);
+  putpkt_notif (buf);
+}
+
 /* Push one event NEW_EVENT of notification NP into NP->queue.  */
 
 void
@@ -140,17 +162,43 @@ notif_push (struct notif_server *np, struct notif_event *new_event)
   notif_event_enque (np, new_event);
 
   /* If this is the first stop reply in the queue, then inform GDB
-     about it, by sending a corresponding notification.  */
-  if (is_first_event)
-    {
-      char buf[PBUFSIZ];
-      char *p = buf;
+     about it, by sending a corresponding notification.  If a batch is
+     being collected, this is done by notif_batch_end instead.  */
+  if (is_first_event && !np->batching)
+    notif_send (np, new_event);
+}
+
+/* Start collecting the events pushed to NP as a batch.  */
+
+void
+notif_batch_begin (struct notif_server *np)
+{
+  gdb_assert (!np->batching);
+
+  np->batching = 1;
+  np->batch_was_empty = QUEUE_is_empty (notif_event_p, np->queue);
+}
+
+/* Stop collecting the events pushed to NP as a batch.  If the batch
+   put the first events in NP->queue, send a single notification for
+   all of them.  Otherwise, GDB is already fetching the queued events,
+   and will get the new ones in the same sequence of acks.  */
+
+void
+notif_batch_end (struct notif_server *np)
+{
+  gdb_assert (np->batching);
+
+  np->batching = 0;
 
-      xsnprintf (p, PBUFSIZ, "%s:", np->notif_name);
-      p += strlen (p);
+  if (np->batch_was_empty
+      && !QUEUE_is_empty (notif_event_p, np->queue))
+    {
+      if (remote_debug)
+	debug_printf ("%s: sending batch of %d events\n", np->notif_name,
+		      QUEUE_length (notif_event_p, np->queue));
 
-      np->write (new_event, p);
-      putpkt_notif (buf);
+      notif_send (np, QUEUE_peek (notif_event_p, np->queue));
     }
 }
 
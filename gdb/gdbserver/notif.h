@@ -50,6 +50,13 @@ typedef struct notif_server
 
   /* Write event EVENT to OWN_BUF.  */
   void (*write) (struct notif_event *event, char *own_buf);
+
+  /* Nonzero while a batch of events is being collected, see
+     notif_batch_begin.  */
+  int batching;
+
+  /* Whether QUEUE was empty when the current batch began.  */
+  int batch_was_empty;
 } *notif_server_p;
 
 extern struct notif_server notif_stop;
@@ -61,4 +68,31 @@ void notif_push (struct notif_server *np, struct notif_event *event);
 void notif_event_enque (struct notif_server *notif,
 			struct notif_event *event);
 
+void notif_batch_begin (struct notif_server *np);
+void notif_batch_end (struct notif_server *np);
+
+/* Collect the events pushed to a notification while an object of
+   this type is live, and announce them all with a single notification
+   when it goes out of scope.  */
+
+class scoped_notif_batch
+{
+public:
+  explicit scoped_notif_batch (struct notif_server *np)
+    : m_np (np)
+  {
+    notif_batch_begin (m_np);
+  }
+
+  ~scoped_notif_batch ()
+  {
+    notif_batch_end (m_np);
+  }
+
+  DISABLE_COPY_AND_ASSIGN (scoped_notif_batch);
+
+private:
+  struct notif_server *m_np;
+};
+
 void initialize_notif (void);
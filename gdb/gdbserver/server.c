@@ -4413,14 +4413,14 @@ push_stop_notification (ptid_t ptid, struct target_waitstatus *status)
   notif_push (&notif_stop, (struct notif_event *) vstop_notif);
 }
 
-/* Event-loop callback for target events.  */
+/* Fetch one event from the target and report it to GDB, or forward
+   it to the inferior if GDB isn't interested in it.  Return true if
+   an event was found, and so more may be pending.  */
 
-int
-handle_target_event (int err, gdb_client_data client_data)
+static bool
+handle_one_target_event ()
 {
   client_state &cs = get_client_state ();
-  if (debug_threads)
-    debug_printf ("handling possible target event\n");
 
   cs.last_ptid = mywait (minus_one_ptid, &cs.last_status,
 		      TARGET_WNOHANG, 1);
@@ -4429,65 +4429,90 @@ handle_target_event (int err, gdb_client_data client_data)
     {
       if (gdb_connected () && report_no_resumed)
 	push_stop_notification (null_ptid, &cs.last_status);
+      return false;
     }
-  else if (cs.last_status.kind != TARGET_WAITKIND_IGNORE)
+  else if (cs.last_status.kind == TARGET_WAITKIND_IGNORE)
+    return false;
+
+  int pid = cs.last_ptid.pid ();
+  struct process_info *process = find_process_pid (pid);
+  int forward_event = !gdb_connected () || process->gdb_detached;
+
+  if (cs.last_status.kind == TARGET_WAITKIND_EXITED
+      || cs.last_status.kind == TARGET_WAITKIND_SIGNALLED)
+    {
+      mark_breakpoints_out (process);
+      target_mourn_inferior (cs.last_ptid);
+    }
+  else if (cs.last_status.kind == TARGET_WAITKIND_THREAD_EXITED)
+    ;
+  else
     {
-      int pid = cs.last_ptid.pid ();
-      struct process_info *process = find_process_pid (pid);
-      int forward_event = !gdb_connected () || process->gdb_detached;
+      /* We're reporting this thread as stopped.  Update its
+	 "want-stopped" state to what the client wants, until it gets
+	 a new resume action.  */
+      current_thread->last_resume_kind = resume_stop;
+      current_thread->last_status = cs.last_status;
+    }
 
-      if (cs.last_status.kind == TARGET_WAITKIND_EXITED
-	  || cs.last_status.kind == TARGET_WAITKIND_SIGNALLED)
+  if (forward_event)
+    {
+      if (!target_running ())
 	{
-	  mark_breakpoints_out (process);
-	  target_mourn_inferior (cs.last_ptid);
+	  /* The last process exited.  We're done.  */
+	  exit (0);
 	}
-      else if (cs.last_status.kind == TARGET_WAITKIND_THREAD_EXITED)
+
+      if (cs.last_status.kind == TARGET_WAITKIND_EXITED
+	  || cs.last_status.kind == TARGET_WAITKIND_SIGNALLED
+	  || cs.last_status.kind == TARGET_WAITKIND_THREAD_EXITED)
 	;
       else
 	{
-	  /* We're reporting this thread as stopped.  Update its
-	     "want-stopped" state to what the client wants, until it
-	     gets a new resume action.  */
-	  current_thread->last_resume_kind = resume_stop;
-	  current_thread->last_status = cs.last_status;
-	}
+	  /* A thread stopped with a signal, but gdb isn't connected to
+	     handle it.  Pass it down to the inferior, as if it wasn't
+	     being traced.  */
+	  enum gdb_signal signal;
 
-      if (forward_event)
-	{
-	  if (!target_running ())
-	    {
-	      /* The last process exited.  We're done.  */
-	      exit (0);
-	    }
+	  if (debug_threads)
+	    debug_printf ("GDB not connected; forwarding event %d for"
+			  " [%s]\n",
+			  (int) cs.last_status.kind,
+			  target_pid_to_str (cs.last_ptid));
 
-	  if (cs.last_status.kind == TARGET_WAITKIND_EXITED
-	      || cs.last_status.kind == TARGET_WAITKIND_SIGNALLED
-	      || cs.last_status.kind == TARGET_WAITKIND_THREAD_EXITED)
-	    ;
+	  if (cs.last_status.kind == TARGET_WAITKIND_STOPPED)
+	    signal = cs.last_status.value.sig;
 	  else
-	    {
-	      /* A thread stopped with a signal, but gdb isn't
-		 connected to handle it.  Pass it down to the
-		 inferior, as if it wasn't being traced.  */
-	      enum gdb_signal signal;
-
-	      if (debug_threads)
-		debug_printf ("GDB not connected; forwarding event %d for"
-			      " [%s]\n",
-			      (int) cs.last_status.kind,
-			      target_pid_to_str (cs.last_ptid));
-
-	      if (cs.last_status.kind == TARGET_WAITKIND_STOPPED)
-		signal = cs.last_status.value.sig;
-	      else
-		signal = GDB_SIGNAL_0;
-	      target_continue (cs.last_ptid, signal);
-	    }
+	    signal = GDB_SIGNAL_0;
+	  target_continue (cs.last_ptid, signal);
 	}
-      else
-	push_stop_notification (cs.last_ptid, &cs.last_status);
     }
+  else
+    push_stop_notification (cs.last_ptid, &cs.last_status);
+
+  return true;
+}
+
+/* Event-loop callback for target events.  */
+
+int
+handle_target_event (int err, gdb_client_data client_data)
+{
+  if (debug_threads)
+    debug_printf ("handling possible target event\n");
+
+  /* Drain all the events the target has ready, instead of returning
+     to the event loop after each one.  When many threads stop at
+     once (e.g., all hitting a breakpoint with a condition that is
+     often true), this sends GDB a single stop notification for the
+     whole batch, and GDB fetches all the events in one go, instead
+     of a notification and an ack sequence per event.  */
+  {
+    scoped_notif_batch batch (&notif_stop);
+
+    while (handle_one_target_event ())
+      ;
+  }
 
   /* Be sure to not change the selected thread behind GDB's back.
      Important in the non-stop mode asynchronous protocol.  */